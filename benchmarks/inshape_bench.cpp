@@ -0,0 +1,394 @@
+/*
+MIT License
+
+Copyright (c) 2023 BJLAB LLC
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Throughput of the generators and post-passes over a few layouts.
+//
+//   inshape_bench [--filter text] [--min-time seconds] [--threads n]
+//                 [--json out.json] [--baseline base.json] [--threshold percent]
+//
+// Every case is run until min-time has passed and reports the median time per run,
+// vertices/s, triangles/s (every 3 indices), bytes allocated and allocations per run.
+// Built with INSHAPE_INSTRUMENT (cmake -DINSHAPE_BENCH_INSTRUMENT=ON) it also reports the
+// vector reallocations of the trace zones per run; the zones cost time of their own.
+// --json writes the results with one case per line,
+// --baseline compares against such a file and fails when a case got slower than
+// threshold percent.
+
+#include "inc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <new>
+
+using namespace INSHAPE;
+
+#if defined(INSHAPE_INSTRUMENT)
+static const bool g_traced = true;
+#else
+static const bool g_traced = false;
+#endif
+
+// ----------------------------------------------------------------------------------
+// allocation counting
+
+// gcc cannot see that the replaced new and delete match once they are inlined
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+  #pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+static atomic<uint64_t> g_allocs{0};
+static atomic<uint64_t> g_allocBytes{0};
+
+void *operator new(size_t n)
+{
+    g_allocs.fetch_add(1, memory_order_relaxed);
+    g_allocBytes.fetch_add(n, memory_order_relaxed);
+    if(void *p = malloc(n ? n : 1)) return p;
+    throw bad_alloc();
+}
+
+void operator delete(void *p) noexcept               { free(p); }
+void operator delete(void *p, size_t) noexcept       { free(p); }
+void *operator new[](size_t n)                       { return operator new(n); }
+void operator delete[](void *p) noexcept             { free(p); }
+void operator delete[](void *p, size_t) noexcept     { free(p); }
+
+// ----------------------------------------------------------------------------------
+struct BenchCase
+{
+    string name;
+    function<void(VtxIdxStruct &)> setup;   // untimed, prepares the input of run
+    function<void(VtxIdxStruct &)> run;
+    VtxIdxStruct layout;
+};
+
+struct BenchResult
+{
+    string   name;
+    double   seconds{0};        // median per run
+    uint64_t vertices{0};       // per run
+    uint64_t triangles{0};
+    uint64_t bytes{0};
+    uint64_t allocs{0};
+    uint64_t reallocs{0};
+    int      runs{0};
+};
+
+struct BenchOptions
+{
+    string filter;
+    double minTime{0.25};
+    int    numThreads{1};
+    string json;
+    string baseline;
+    double threshold{10.};
+};
+
+static VtxIdxStruct makeLayout(const char *name)
+{
+    VtxIdxStruct vis;
+    if(!strcmp(name, "PNF")) {
+        VtxLayout<Pos, Normal, FaceID>::apply(vis);
+    } else if(!strcmp(name, "PNCFT")) {
+        VtxLayout<Pos, Normal, Color, FaceID, UV<0,2>>::apply(vis);
+    }
+    return vis;
+}
+
+static BenchResult runCase(const BenchCase &c, const BenchOptions &o)
+{
+    using clock = chrono::steady_clock;
+
+    BenchResult r;
+    r.name = c.name;
+
+    vector<double> times;
+    const clock::time_point start = clock::now();
+    do {
+        VtxIdxStruct vis = c.layout.cloneLayout();
+        if(c.setup) c.setup(vis);
+        const size_t nv0 = vis.vtxData.size() / vis.stride;
+        const size_t ni0 = vis.idxData.size();
+
+        const uint64_t a0 = g_allocs.load(), b0 = g_allocBytes.load(), r0 = traceTotals().reallocs;
+        const clock::time_point t0 = clock::now();
+        c.run(vis);
+        const clock::time_point t1 = clock::now();
+
+        times.push_back(chrono::duration<double>(t1 - t0).count());
+        r.allocs   = g_allocs.load() - a0;
+        r.bytes    = g_allocBytes.load() - b0;
+        r.reallocs = traceTotals().reallocs - r0;
+
+        // post-passes work on the prepared input in place
+        const size_t nv = vis.vtxData.size() / vis.stride;
+        const size_t ni = vis.idxData.size();
+        r.vertices  = nv > nv0 ? nv - nv0 : nv;
+        r.triangles = (ni > ni0 ? ni - ni0 : ni) / 3;
+    } while(chrono::duration<double>(clock::now() - start).count() < o.minTime || times.size() < 3);
+
+    sort(times.begin(), times.end());
+    r.seconds = times[times.size()/2];
+    r.runs    = int(times.size());
+    return r;
+}
+
+// ----------------------------------------------------------------------------------
+// cases
+
+static void addGeneratorCases(vector<BenchCase> &cases, const char *layoutName, const int nt)
+{
+    const VtxIdxStruct layout = makeLayout(layoutName);
+    auto add = [&](const string &name, function<void(VtxIdxStruct &)> run) {
+        cases.push_back(BenchCase{name + "/" + layoutName, nullptr, run, layout});
+    };
+    const string threads = "/t" + to_string(nt);
+
+    // many small primitives, as in a scene build
+    add("append_plane/x10000", [](VtxIdxStruct &vis) {
+        for(int i=0; i<10000; i++) append_plane(vis, 0.f, 1.f, 0.f, 1.f, 1, 1, true);
+    });
+    add("append_box/x10000", [](VtxIdxStruct &vis) {
+        for(int i=0; i<10000; i++) append_box(vis, 0.f, 1.f, 0.f, 2.f, 0.f, 3.f);
+    });
+    add("append_plane/g512", [](VtxIdxStruct &vis) { append_plane(vis, 0.f, 1.f, 0.f, 1.f, 512, 512, true); });
+    add("append_box/g64/x10", [](VtxIdxStruct &vis) {
+        for(int i=0; i<10; i++) append_box(vis, 0.f, 1.f, 0.f, 2.f, 0.f, 3.f, 64, 64, 64);
+    });
+    add("append_icosahedron/x10000", [](VtxIdxStruct &vis) {
+        for(int i=0; i<10000; i++) append_icosahedron(vis, 1.f);
+    });
+    for(int n : {16, 256}) {
+        add("append_disk/n" + to_string(n) + "/x1000", [n](VtxIdxStruct &vis) {
+            for(int i=0; i<1000; i++) append_disk(vis, 0.f, true, 1.f, n);
+        });
+        add("append_ring/n" + to_string(n) + "/x1000", [n](VtxIdxStruct &vis) {
+            for(int i=0; i<1000; i++) append_ring(vis, 0.f, true, 0.5f, 1.f, n);
+        });
+    }
+    for(int nL : {1, 64}) {
+        for(int nS : {16, 256}) {
+            const int count = nL*nS > 1024 ? 10 : 1000;
+            add("append_tube/l" + to_string(nL) + "s" + to_string(nS) + "/x" + to_string(count) + threads,
+                [=](VtxIdxStruct &vis) {
+                    for(int i=0; i<count; i++) append_tube(vis, 0.f, 1.f, 1.f, 0.5f, nL, nS, false, nt);
+                });
+        }
+    }
+    for(int s : {3, 6}) {
+        add("append_sphere_icosahedron/s" + to_string(s) + threads, [=](VtxIdxStruct &vis) {
+            const int count = s < 5 ? 100 : 1;
+            for(int i=0; i<count; i++) append_sphere_icosahedron(vis, 1.f, s, nt);
+        });
+    }
+    for(int n : {32, 100}) {
+        add("append_sphere_geodesic/n" + to_string(n) + threads, [=](VtxIdxStruct &vis) {
+            for(int i=0; i<10; i++) append_sphere_geodesic(vis, 1.f, n, nt);
+        });
+    }
+    add("append_points/n1000000" + threads, [=](VtxIdxStruct &vis) { append_points(vis, 1000000, nt); });
+    add("append_lines/n100000", [](VtxIdxStruct &vis) { append_lines(vis, 100000); });
+
+    add("generate_cylinder/l4s64/x1000" + threads, [=](VtxIdxStruct &vis) {
+        for(int i=0; i<1000; i++) generate_cylinder(vis, 0.f, 1.f, 1.f, 0.5f, 4, 64, nt);
+    });
+    add("generate_hollowCylinder/l4s64/x1000", [](VtxIdxStruct &vis) {
+        for(int i=0; i<1000; i++) generate_hollowCylinder(vis, 0.f, 1.f, 0.5f, 0.5f, 1.f, 1.f, 4, 64);
+    });
+    add("generate_plane/x10000", [](VtxIdxStruct &vis) {
+        for(int i=0; i<10000; i++) generate_plane(vis, 0.f, 1.f, 0.f, 1.f, 1, 1);
+    });
+    add("generate_box/x10000", [](VtxIdxStruct &vis) {
+        for(int i=0; i<10000; i++) generate_box(vis, 0.f, 1.f, 0.f, 1.f, 0.f, 1.f, 1, 1, 1);
+    });
+    add("generate_sphere/s5" + threads, [=](VtxIdxStruct &vis) { generate_sphere(vis, 1.f, 5, nt); });
+    add("generate_points/n1000000" + threads, [=](VtxIdxStruct &vis) { generate_points(vis, 1000000, nt); });
+    add("generate_lines/n100000", [](VtxIdxStruct &vis) { generate_lines(vis, 100000); });
+    add("generate_sphere_lods/s6l4" + threads, [=](VtxIdxStruct &vis) { generate_sphere_lods(vis, 1.f, 6, 4, nt); });
+    add("generate_cylinder_lods/l16s256l4" + threads, [=](VtxIdxStruct &vis) {
+        generate_cylinder_lods(vis, 0.f, 1.f, 1.f, 0.5f, 16, 256, 4, nt);
+    });
+
+    add("append_instances/box/x10000", [](VtxIdxStruct &vis) {
+        VtxIdxInstanced inst;
+        inst.base  = vis.cloneLayout();
+        inst.range = append_box(inst.base, 0.f, 1.f, 0.f, 1.f, 0.f, 1.f);
+        const float col[4] {1.f, 0.f, 0.f, 1.f};
+        for(int i=0; i<10000; i++) {
+            const float T[16] {1,0,0,float(i), 0,1,0,0, 0,0,1,0, 0,0,0,1};
+            addInstance(inst, T, col, i);
+        }
+        append_instances(vis, inst);
+    });
+}
+
+static void addPostPassCases(vector<BenchCase> &cases, const char *layoutName, const int nt)
+{
+    const VtxIdxStruct layout = makeLayout(layoutName);
+    const string threads = "/t" + to_string(nt);
+
+    // a sphere with 655k vertices as input
+    auto sphere = [](VtxIdxStruct &vis) { append_sphere_icosahedron(vis, 1.f, 7); };
+    auto add = [&](const string &name, function<void(VtxIdxStruct &)> run) {
+        cases.push_back(BenchCase{name + "/" + layoutName, sphere, run, layout});
+    };
+
+    add("transform/sphere7", [](VtxIdxStruct &vis) {
+        const float T[16] {0.f,-1.f,0.f,1.f, 1.f,0.f,0.f,2.f, 0.f,0.f,2.f,3.f, 0.f,0.f,0.f,1.f};
+        transform(T, vis);
+    });
+    if(layout.offset_color >= 0) {
+        add("setVertexColor/sphere7", [](VtxIdxStruct &vis) {
+            const float col[4] {0.2f, 0.4f, 0.6f, 1.f};
+            setVertexColor(col, vis);
+        });
+    }
+    if(layout.numTexCoords[0] >= 2) {
+        add("addTexcoords/sphere7", [](VtxIdxStruct &vis) { addTexcoords(vis, 0, -1.f, 1.f, -1.f, 1.f); });
+    }
+    add("subdivide/sphere7" + threads, [=](VtxIdxStruct &vis) {
+        vector<float> vtx;
+        vector<int>   idx;
+        subdivide(vtx, idx, vis.vtxData, vis.idxData, vis.stride, nt);
+        vis.vtxData.swap(vtx);
+        vis.idxData.swap(idx);
+    });
+    add("buildOpp/sphere7" + threads, [=](VtxIdxStruct &vis) {
+        vector<int> opp;
+        OppScratch  scratch;
+        buildOpp(opp, vis.idxData.data(), int(vis.idxData.size()), scratch, nt);
+    });
+}
+
+// ----------------------------------------------------------------------------------
+// baseline: the "name" and "seconds" fields of each line written by writeJson
+
+static unordered_map<string, double> readBaseline(const string &path)
+{
+    unordered_map<string, double> base;
+    FILE *f = fopen(path.c_str(), "r");
+    if(!f) return base;
+
+    char line[1024];
+    while(fgets(line, sizeof(line), f)) {
+        const char *n = strstr(line, "\"name\": \"");
+        const char *s = strstr(line, "\"seconds\": ");
+        if(!n || !s) continue;
+        n += 9;
+        const char *e = strchr(n, '"');
+        if(!e) continue;
+        base[string(n, e)] = atof(s + 11);
+    }
+    fclose(f);
+    return base;
+}
+
+static bool writeJson(const string &path, const vector<BenchResult> &results, const BenchOptions &o)
+{
+    FILE *f = fopen(path.c_str(), "w");
+    if(!f) return false;
+
+    fprintf(f, "{\n  \"threads\": %d,\n  \"results\": [\n", o.numThreads);
+    for(size_t i=0; i<results.size(); i++) {
+        const BenchResult &r = results[i];
+        fprintf(f, "    {\"name\": \"%s\", \"seconds\": %.9g, \"vertices_per_s\": %.6g, \"triangles_per_s\": %.6g,"
+                   " \"vertices\": %llu, \"triangles\": %llu, \"bytes_allocated\": %llu, \"allocations\": %llu,%s \"runs\": %d}%s\n",
+            r.name.c_str(), r.seconds, r.vertices / r.seconds, r.triangles / r.seconds,
+            (unsigned long long)r.vertices, (unsigned long long)r.triangles,
+            (unsigned long long)r.bytes, (unsigned long long)r.allocs,
+            g_traced ? (" \"reallocations\": " + to_string(r.reallocs) + ",").c_str() : "", r.runs,
+            i+1 < results.size() ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    return fclose(f) == 0;
+}
+
+// ----------------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+    BenchOptions o;
+    for(int i=1; i<argc; i++) {
+        const string a = argv[i];
+        const bool   v = i+1 < argc;
+        if     (a == "--filter"    && v) o.filter     = argv[++i];
+        else if(a == "--min-time"  && v) o.minTime    = atof(argv[++i]);
+        else if(a == "--threads"   && v) o.numThreads = max(1, atoi(argv[++i]));
+        else if(a == "--json"      && v) o.json       = argv[++i];
+        else if(a == "--baseline"  && v) o.baseline   = argv[++i];
+        else if(a == "--threshold" && v) o.threshold  = atof(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--filter text] [--min-time s] [--threads n]"
+                            " [--json out.json] [--baseline base.json] [--threshold percent]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    vector<BenchCase> cases;
+    for(const char *layout : {"P", "PNF", "PNCFT"}) {
+        addGeneratorCases(cases, layout, o.numThreads);
+        addPostPassCases(cases, layout, o.numThreads);
+    }
+
+    const unordered_map<string, double> base = o.baseline.size() ? readBaseline(o.baseline)
+                                                                 : unordered_map<string, double>();
+    if(o.baseline.size() && base.empty()) {
+        fprintf(stderr, "cannot read baseline %s\n", o.baseline.c_str());
+        return 2;
+    }
+
+    printf("%-52s %10s %10s %10s %12s %8s %8s\n", "case", "ms", "Mvtx/s", "Mtri/s", "MB alloc", "allocs", "reallocs");
+
+    vector<BenchResult> results;
+    int regressions = 0;
+    for(const BenchCase &c : cases) {
+        if(o.filter.size() && c.name.find(o.filter) == string::npos) continue;
+
+        const BenchResult r = runCase(c, o);
+        results.push_back(r);
+        printf("%-52s %10.3f %10.2f %10.2f %12.2f %8llu %8s", r.name.c_str(), r.seconds*1e3,
+            r.vertices / r.seconds * 1e-6, r.triangles / r.seconds * 1e-6, r.bytes / 1048576.,
+            (unsigned long long)r.allocs, g_traced ? to_string(r.reallocs).c_str() : "-");
+
+        auto it = base.find(r.name);
+        if(it != base.end() && it->second > 0) {
+            const double change = (r.seconds / it->second - 1.) * 100.;
+            const bool   slower = change > o.threshold;
+            regressions += slower;
+            printf("  %+6.1f%%%s", change, slower ? "  SLOWER" : "");
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+
+    if(o.json.size() && !writeJson(o.json, results, o)) {
+        fprintf(stderr, "cannot write %s\n", o.json.c_str());
+        return 2;
+    }
+    if(regressions) {
+        printf("%d case(s) slower than the baseline by more than %.1f%%\n", regressions, o.threshold);
+        return 1;
+    }
+    return 0;
+}